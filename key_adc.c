@@ -0,0 +1,109 @@
+/******************************************************************************************
+* @file         : key_adc.c
+* @Description  : Resistor ladder ADC key input for the key input driver framework
+ * ******************************************************************************************/
+#include "../include/key_adc.h"
+#include <stddef.h>
+
+/**********************************************************************
+ * 函数名称： key_adc_init
+ * 功能描述： 初始化ADC按键，需在注册按键（key_ops.init）之前调用，
+ *           按键改为外部输入，不再初始化和读取GPIO
+ * 输入参数： adc，thr 阈值表（key_num+1个升序边界），keys，key_num
+ * 输出参数： 无
+ * 返 回 值： 0 成功，-1 参数错误或按键已注册
+ ***********************************************************************/
+int key_adc_init(key_adc_t *adc, const uint16_t *thr, key_dev_t **keys, unsigned char key_num)
+{
+	if(NULL == adc || NULL == thr || NULL == keys || 0 == key_num || key_num > KEY_ADC_MAX_KEYS)
+		return -1;
+
+	/* 阈值必须升序 */
+	for(unsigned char i = 0; i < key_num; i++)
+	{
+		if(thr[i] >= thr[i + 1])
+			return -1;
+	}
+
+	/* 已注册的按键已初始化GPIO，不能再改为外部输入 */
+	for(unsigned char i = 0; i < key_num; i++)
+	{
+		if(NULL == keys[i] || NULL != keys[i]->ctx)
+			return -1;
+	}
+
+	adc->thr = thr;
+	adc->keys = keys;
+	adc->key_num = key_num;
+	adc->active = key_num;
+
+	for(unsigned char i = 0; i < key_num; i++)
+	{
+		keys[i]->ext_src = true;
+		keys[i]->ext_level = KEY_OFF;
+	}
+	return 0;
+}
+
+/**********************************************************************
+ * 函数名称： key_adc_feed_block
+ * 功能描述： 对一组采样（如DMA缓冲区）做阈值分类，过半数采样落在同一
+ *           按键区间时判定该按键按下，结果供下一次key_scan使用
+ *           分类按阈值逐个统计不小于该阈值的采样数，内层循环无分支，
+ *           便于编译器向量化，过采样抑制噪声的开销较小
+ * 输入参数： adc，samples，num 采样数
+ * 输出参数： 无
+ * 返 回 值： 无
+ ***********************************************************************/
+void key_adc_feed_block(key_adc_t *adc, const uint16_t *samples, unsigned int num)
+{
+	unsigned int ge_cnt[KEY_ADC_MAX_KEYS + 1];
+	unsigned char active;
+
+	if(NULL == adc || NULL == adc->thr || NULL == samples || 0 == num)
+		return;
+	active = adc->key_num;
+
+	/* 统计不小于各阈值的采样数 */
+	for(unsigned char i = 0; i <= adc->key_num; i++)
+	{
+		const uint16_t thr = adc->thr[i];
+		unsigned int cnt = 0;
+
+		for(unsigned int n = 0; n < num; n++)
+			cnt += (samples[n] >= thr);
+		ge_cnt[i] = cnt;
+	}
+
+	/* 区间[thr[i], thr[i+1])内的采样数为相邻两阈值计数之差 */
+	for(unsigned char i = 0; i < adc->key_num; i++)
+	{
+		if((ge_cnt[i] - ge_cnt[i + 1]) * 2 > num)
+		{
+			active = i;
+			break;
+		}
+	}
+
+	/* 按判定结果更新各按键电平 */
+	if(active != adc->active)
+	{
+		if(adc->active < adc->key_num)
+			adc->keys[adc->active]->ext_level = KEY_OFF;
+		if(active < adc->key_num)
+			adc->keys[active]->ext_level = KEY_ON;
+		adc->active = active;
+	}
+}
+
+/**********************************************************************
+ * 函数名称： key_adc_feed
+ * 功能描述： 输入单个ADC采样
+ * 输入参数： adc，sample
+ * 输出参数： 无
+ * 返 回 值： 无
+ ***********************************************************************/
+void key_adc_feed(key_adc_t *adc, uint16_t sample)
+{
+	key_adc_feed_block(adc, &sample, 1);
+}
@@ -0,0 +1,32 @@
+#ifndef KEY_ADC_H
+#define KEY_ADC_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "key_input.h"
+#include <stdint.h>
+
+/* 单个ADC通道上的最大按键数 */
+#define KEY_ADC_MAX_KEYS 8
+
+/* 电阻分压ADC按键，一个通道上挂多个按键，同一时刻只判定一个按键按下
+ * 阈值表为 key_num+1 个升序边界，采样值落在 [thr[i], thr[i+1]) 时判定keys[i]按下，
+ * 小于thr[0]或不小于thr[key_num]时判定无按键按下 */
+typedef struct stKey_adc
+{
+	const uint16_t *thr;		/* 阈值表 */
+	key_dev_t **keys;			/* 与阈值区间对应的按键 */
+	unsigned char key_num;		/* 按键数 */
+	unsigned char active;		/* 当前判定按下的按键，key_num表示无 */
+}key_adc_t;
+
+extern int key_adc_init(key_adc_t *adc, const uint16_t *thr, key_dev_t **keys, unsigned char key_num);
+extern void key_adc_feed(key_adc_t *adc, uint16_t sample);
+extern void key_adc_feed_block(key_adc_t *adc, const uint16_t *samples, unsigned int num);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -37,53 +37,113 @@ key_dev_t key3 = {
 						.IO_PinSel = Pin06,	//用户可配置
 					},
 };
-/* keyinput总数 */
-static uint32_t pressed_cnt = 1;
+/* 默认上下文，未初始化时在注册第一个按键时初始化 */
+key_ctx_t key_ctx_def;
 
-/* 头节点 */
-static key_dev_t * key_cbhead = NULL;
+/**********************************************************************
+ * 函数名称： key_ctx_init
+ * 功能描述： 初始化按键上下文
+ * 输入参数： ctx
+ * 输出参数： 无
+ * 返 回 值： 无
+ ***********************************************************************/
+void key_ctx_init(key_ctx_t *ctx)
+{
+	if(NULL == ctx)
+		return;
+
+	memset(ctx, 0, sizeof(key_ctx_t));
+	ctx->pressed_cnt = 1;
+
+	/* 事件存储串成空闲链表 */
+	for(unsigned int i = 0; i < KEY_EVT_MAX_TOTAL; i++)
+	{
+		ctx->evt_pool[i].evt_next = ctx->evt_free;
+		ctx->evt_free = &ctx->evt_pool[i];
+	}
+	ctx->ready = true;
+}
+
+/**********************************************************************
+ * 函数名称： key_io_Init
+ * 功能描述： 初始化按键io，未指定io操作时使用板级GPIO，
+ *           回放/仿真可预先填入自己的io操作
+ * 输入参数： key_dev
+ * 输出参数： 无
+ * 返 回 值： 无
+ ***********************************************************************/
+static void key_io_Init(key_dev_t *key_dev)
+{
+	if(NULL == key_dev->key_io.InitHandler)
+		key_dev->key_io.InitHandler = xs_GpioInit;
+	if(NULL == key_dev->key_io.GetbitHandler)
+		key_dev->key_io.GetbitHandler = xs_GpioGetBit;
+	key_dev->key_io.InitHandler(&key_dev->key_io);
+}
 
 /**********************************************************************
  * 函数名称： key_stc_Init
  * 功能描述： 初始化key_dev
- * 输入参数： key_dev
+ * 输入参数： ctx，key_dev
  * 输出参数： 无
  * 返 回 值： 无
  * 修改日期        版本号     修改人	      修改内容
  * -----------------------------------------------
  * 2023/08/31	    V1.0	  jinyicheng	      创建
  ***********************************************************************/
-static void key_stc_Init(key_dev_t *key_dev)
+static void key_stc_Init(key_ctx_t *ctx,key_dev_t *key_dev)
 {
+	key_dev->ctx = ctx;
 	key_dev->dev_next = NULL;
 	key_dev->evt_Index = NULL;
-	key_dev->key_io.InitHandler = xs_GpioInit;
-	key_dev->key_io.GetbitHandler = xs_GpioGetBit;
-	key_dev->key_io.InitHandler(&key_dev->key_io);
+	key_dev->evt_Tail = NULL;
+	key_dev->evt_cnt = 0;
+	key_dev->evt_ovf = 0;
+	/* 分配最小的空闲key_id，超出路由表规模的按键只能使用static_hand */
+	key_dev->key_id = KEY_MAX_NUM;
+	for(unsigned char id = 0; id < KEY_MAX_NUM; id++)
+	{
+		if(0 == (ctx->id_used & (1UL << id)))
+		{
+			ctx->id_used |= (1UL << id);
+			key_dev->key_id = id;
+			break;
+		}
+	}
+	if(!key_dev->ext_src)
+		key_io_Init(key_dev);
 	key_dev->key_state = KEY_UNPRESSED;
+	key_dev->deshake_tick = DESHAKE_SLICE * KEYSACN_TIMEBASE;
+	key_dev->bounce_tick = 0;
+	key_dev->bounce_max = 0;
+	key_dev->bounce_meas = false;
+	key_dev->last_level = KEY_OFF;
+	key_dev->down_sent = false;
 }
 
 /**********************************************************************
- * 函数名称： key_Init
- * 功能描述： 注册按键
- * 输入参数： key_dev,key_handler
+ * 函数名称： key_Init_ctx
+ * 功能描述： 在指定上下文中注册按键
+ * 输入参数： ctx,key_dev,key_handler
  * 输出参数： 无
  * 返 回 值： 无
- * 修改日期        版本号     修改人	      修改内容
- * -----------------------------------------------
- * 2023/08/31	    V1.0	  jinyicheng	      创建
  ***********************************************************************/
-void key_Init(key_dev_t *key_dev, key_static_handler key_handler)
+void key_Init_ctx(key_ctx_t *ctx, key_dev_t *key_dev, key_static_handler key_handler)
 {
-	if(NULL == key_cbhead)
+	if(NULL == ctx || NULL == key_dev)
+		return;
+	if(!ctx->ready)
+		key_ctx_init(ctx);
+
+	if(NULL == ctx->dev_head)
 	{
-		key_cbhead = key_dev;
+		ctx->dev_head = key_dev;
 		key_dev->static_hand = key_handler;
-		key_stc_Init(key_dev);
+		key_stc_Init(ctx,key_dev);
 		return;
 	}
 	
-	key_dev_t *p_temp = key_cbhead;
+	key_dev_t *p_temp = ctx->dev_head;
 	key_dev_t *p_Index = p_temp;
 	/* 遍历链表，找到尾部节点 */
 	for(;NULL != p_Index;p_Index = p_temp->dev_next)
@@ -94,7 +154,22 @@ void key_Init(key_dev_t *key_dev, key_static_handler key_handler)
 	p_temp->dev_next = key_dev;
 	
 	key_dev->static_hand = key_handler;
-	key_stc_Init(key_dev);
+	key_stc_Init(ctx,key_dev);
+}
+
+/**********************************************************************
+ * 函数名称： key_Init
+ * 功能描述： 在默认上下文中注册按键
+ * 输入参数： key_dev,key_handler
+ * 输出参数： 无
+ * 返 回 值： 无
+ * 修改日期        版本号     修改人	      修改内容
+ * -----------------------------------------------
+ * 2023/08/31	    V1.0	  jinyicheng	      创建
+ ***********************************************************************/
+void key_Init(key_dev_t *key_dev, key_static_handler key_handler)
+{
+	key_Init_ctx(&key_ctx_def,key_dev,key_handler);
 }
 
 /**********************************************************************
@@ -111,6 +186,10 @@ static KEY_STATE key_getvalue(key_dev_t *key_dev)
 {
 	KEY_STATE val;
 	
+	/* 外部输入的按键直接使用已判定的电平 */
+	if(key_dev->ext_src)
+		return key_dev->ext_level;
+
 	/* 读取按键输入电平 */
 	val = key_dev->key_io.GetbitHandler(&key_dev->key_io);
 	
@@ -118,7 +197,96 @@ static KEY_STATE key_getvalue(key_dev_t *key_dev)
 }
 
 /**********************************************************************
- * 函数名称： key_getvalue
+ * 函数名称： key_evt_pop
+ * 功能描述： 删除第一个事件节点，归还上下文事件存储
+ * 输入参数： key_dev
+ * 输出参数： 无
+ * 返 回 值： 无
+ ***********************************************************************/
+static void key_evt_pop(key_dev_t *key_dev)
+{
+	key_ctx_t *ctx = key_dev->ctx;
+	key_event_t *p = key_dev->evt_Index;
+
+	if(NULL == p)
+		return;
+
+	key_dev->evt_Index = p->evt_next;
+	if(NULL == key_dev->evt_Index)
+		key_dev->evt_Tail = NULL;
+	key_dev->evt_cnt--;
+	ctx->evt_total--;
+	ctx->prio_pending[key_dev->prio_class]--;
+
+	p->evt_next = ctx->evt_free;
+	ctx->evt_free = p;
+}
+
+/**********************************************************************
+ * 函数名称： key_evt_overflow
+ * 功能描述： 事件缓存溢出，按按键的溢出策略处理
+ * 输入参数： key_dev，key_val
+ * 输出参数： 无
+ * 返 回 值： true 事件已处理（丢弃或合并），false 已腾出空间，继续插入
+ ***********************************************************************/
+static bool key_evt_overflow(key_dev_t *key_dev,key_val_t key_val)
+{
+	key_event_t *p_Index;
+	key_event_t *p_last = NULL;
+
+	key_dev->evt_ovf++;
+	key_dev->ctx->evt_ovf++;
+
+	switch(key_dev->ovf_policy)
+	{
+		case KEY_OVF_DROP_OLDEST:
+			/* 只能腾出本键的事件，不影响其他按键 */
+			if(NULL == key_dev->evt_Index)
+				return true;
+			key_evt_pop(key_dev);
+			return false;
+		case KEY_OVF_MERGE:
+			/* 找到最后一个同键值事件 */
+			for(p_Index = key_dev->evt_Index;NULL != p_Index;p_Index = p_Index->evt_next)
+			{
+				if(key_val == p_Index->key_val)
+					p_last = p_Index;
+			}
+			if(NULL != p_last)
+				p_last->merge_cnt++;
+			return true;
+		case KEY_OVF_DROP_NEWEST:
+		default:
+			return true;
+	}
+}
+
+/**********************************************************************
+ * 函数名称： key_evt_dispatch
+ * 功能描述： 将事件分发给static_hand及路由表中的订阅者
+ * 输入参数： key_dev，key_val
+ * 输出参数： 无
+ * 返 回 值： 无
+ ***********************************************************************/
+static void key_evt_dispatch(key_dev_t *key_dev,key_val_t key_val)
+{
+	if(NULL != key_dev->static_hand)
+		key_dev->static_hand(key_val);
+
+	if(key_dev->key_id >= KEY_MAX_NUM || (unsigned int)key_val >= KEY_VAL_NUM)
+		return;
+
+	/* 只遍历订阅了该键值的处理函数 */
+	key_sub_handler *route = key_dev->ctx->route[key_dev->key_id][key_val];
+	unsigned char num = key_dev->ctx->route_num[key_dev->key_id][key_val];
+	for(unsigned char i = 0; i < num; i++)
+	{
+		route[i](key_dev,key_val);
+	}
+}
+
+/**********************************************************************
+ * 函数名称： key_evt_record
  * 功能描述： 以链表形式记录键值
  * 输入参数： key_dev，key_val
  * 输出参数： 无
@@ -129,67 +297,150 @@ static KEY_STATE key_getvalue(key_dev_t *key_dev)
  ***********************************************************************/
 static void key_evt_record(key_dev_t *key_dev,key_val_t key_val)
 {
-	/* 若没有事件列表位空，则插入第一个 */
-	if(NULL == key_dev->evt_Index)
+	key_ctx_t *ctx = key_dev->ctx;
+
+	/* 关键事件不排队，在扫描中直接分发给static_hand及订阅者 */
+	if(KEY_PRIO_CRITICAL == key_dev->prio_class && ctx->crit_direct)
 	{
-		key_event_t * key_evthead = (key_event_t *)tAllocHeapforeach(sizeof(key_event_t));
-		if(NULL == key_evthead)
-		{
-			return;
-		}
-		key_evthead->key_val = key_val;
-		key_evthead->evt_next = NULL;
-		pressed_cnt++;
-		key_evthead->prio = pressed_cnt;
-		key_dev->evt_Index = key_evthead;
+		ctx->pressed_cnt++;
+		key_evt_dispatch(key_dev,key_val);
 		return;
 	}
 
-	/* 在事件列表尾部添加事件，由于是单向链表所以时间复杂度较高 */
-	key_event_t *key_evt = (key_event_t *)tAllocHeapforeach(sizeof(key_event_t));
+	/* 超出单键或全局上限 */
+	if(key_dev->evt_cnt >= KEY_EVT_MAX_PER_KEY || ctx->evt_total >= KEY_EVT_MAX_TOTAL)
+	{
+		if(key_evt_overflow(key_dev,key_val))
+			return;
+	}
+
+	/* 从事件池取出，全局上限等于事件池大小，正常不会取空 */
+	key_event_t *key_evt = ctx->evt_free;
 	if(NULL == key_evt)
 	{
+		key_dev->evt_ovf++;
+		ctx->evt_ovf++;
 		return;
 	}
-	key_event_t *p_temp = key_cbhead->evt_Index;
-	key_event_t *p_Index = p_temp;
-	for(;NULL != p_Index;p_Index = p_temp->evt_next)
+	ctx->evt_free = key_evt->evt_next;
+
+	key_evt->key_val = key_val;
+	key_evt->merge_cnt = 0;
+	key_evt->evt_next = NULL;
+	ctx->pressed_cnt++;
+	key_evt->prio = ctx->pressed_cnt;
+
+	/* 在事件列表尾部添加事件 */
+	if(NULL == key_dev->evt_Index)
+		key_dev->evt_Index = key_evt;
+	else
+		key_dev->evt_Tail->evt_next = key_evt;
+	key_dev->evt_Tail = key_evt;
+
+	key_dev->evt_cnt++;
+	ctx->evt_total++;
+	ctx->prio_pending[key_dev->prio_class]++;
+}
+
+/**********************************************************************
+ * 函数名称： key_bounce_measure
+ * 功能描述： 测量按下时的抖动时间，即首个边沿到最后一个边沿的时间
+ * 输入参数： key_dev，key_level 本周期电平，period 距上次扫描的时间
+ * 输出参数： 无
+ * 返 回 值： 无
+ ***********************************************************************/
+static void key_bounce_measure(key_dev_t *key_dev,KEY_STATE key_level,unsigned int period)
+{
+	if(key_dev->bounce_meas)
 	{
-		p_temp = p_Index;
+		key_dev->edge_tick += period;
+		if(key_level != key_dev->last_level)
+		{
+			key_dev->last_edge = key_dev->edge_tick;
+		}
+		/* 已回到未按下且长时间无边沿，视为干扰，放弃本次测量 */
+		else if(KEY_OFF == key_level && KEY_UNPRESSED == key_dev->key_state
+			&& key_dev->edge_tick - key_dev->last_edge > KEY_DESHAKE_MAX)
+		{
+			key_dev->bounce_meas = false;
+		}
 	}
-	p_temp->evt_next = key_evt;
-	p_temp->evt_next->key_val = key_val;
-	p_temp->evt_next->evt_next = NULL;
-	pressed_cnt++;
-	p_temp->evt_next->prio = pressed_cnt;
+	else if(KEY_ON == key_level && KEY_OFF == key_dev->last_level && KEY_UNPRESSED == key_dev->key_state)
+	{
+		/* 首个按下边沿，开始测量 */
+		key_dev->bounce_meas = true;
+		key_dev->edge_tick = 0;
+		key_dev->last_edge = 0;
+	}
+	key_dev->last_level = key_level;
 }
 
 /**********************************************************************
- * 函数名称： key_scan
- * 功能描述： 周期扫描按键键值
- * 输入参数： 无
+ * 函数名称： key_deshake_adapt
+ * 功能描述： 按下确认后根据测得的抖动时间调整消抖时间，
+ *           抖动变大时立即跟随，变小时缓慢收敛，
+ *           不小于KEY_DESHAKE_MIN及扫描周期（测量分辨率）
+ * 输入参数： key_dev，period 距上次扫描的时间
  * 输出参数： 无
  * 返 回 值： 无
- * 修改日期        版本号     修改人	      修改内容
- * -----------------------------------------------
- * 2023/08/31	    V1.0	  jinyicheng	      创建
  ***********************************************************************/
-void key_scan(void)
+static void key_deshake_adapt(key_dev_t *key_dev,unsigned int period)
+{
+	unsigned int bounce;
+	unsigned int deshake_min = (period > KEY_DESHAKE_MIN) ? period : KEY_DESHAKE_MIN;
+
+	if(!key_dev->bounce_meas)
+		return;
+	key_dev->bounce_meas = false;
+
+	bounce = key_dev->last_edge;
+	key_dev->bounce_tick = bounce;
+	if(bounce > key_dev->bounce_max)
+		key_dev->bounce_max = bounce;
+
+	if(bounce >= key_dev->deshake_tick)
+		key_dev->deshake_tick = bounce;
+	else
+		key_dev->deshake_tick = (key_dev->deshake_tick * 3 + bounce) / 4;
+
+	if(key_dev->deshake_tick < deshake_min)
+		key_dev->deshake_tick = deshake_min;
+	if(key_dev->deshake_tick > KEY_DESHAKE_MAX)
+		key_dev->deshake_tick = KEY_DESHAKE_MAX;
+}
+
+/**********************************************************************
+ * 函数名称： key_scan_period
+ * 功能描述： 扫描按键键值，计时按实际扫描间隔累加
+ *           快照按键只由块扫描处理，其余按键只由逐次扫描处理，
+ *           避免同一时间段内被两种扫描重复计时
+ * 输入参数： ctx，period 距上次扫描的时间(ms)，snap 为true时扫描快照按键
+ * 输出参数： 无
+ * 返 回 值： 无
+ ***********************************************************************/
+static void key_scan_period(key_ctx_t *ctx,unsigned int period,bool snap)
 {
-	key_dev_t *p_temp = key_cbhead;
+	key_dev_t *p_temp = ctx->dev_head;
 	key_dev_t *p_Index = p_temp;
 	KEY_STATE key_instState;
+	unsigned char gesture;
 	
 	for(;NULL != p_Index;p_Index = p_temp->dev_next)
 	{
 		p_temp = p_Index;
+		if((0 != p_Index->snap_mask) != snap)
+			continue;
+		gesture = p_Index->gesture ? p_Index->gesture : KEY_GES_DEFAULT;
 
 		/* 读取IO瞬时电平 */
 		key_instState = key_getvalue(p_Index);
 		
 		/* 若瞬时电平等于按下电平，按下持续时间+1周期 */
 		if(KEY_ON == key_instState)
-			p_Index->hold_tick += KEYSACN_TIMEBASE;
+			p_Index->hold_tick += period;
+
+		/* 测量抖动时间 */
+		key_bounce_measure(p_Index,key_instState,period);
 
 		switch(p_Index->key_state)
 		{
@@ -209,14 +460,29 @@ void key_scan(void)
 				{
 					if(KEY_UNPRESSED == key_instState)
 					{
+						/* 按下时间不足短按，已上报的KEY_DOWN需撤销 */
+						if(p_Index->down_sent)
+						{
+							p_Index->down_sent = false;
+							key_evt_record(p_Index,KEY_UP);
+						}
 						p_Index->key_state = KEY_UNPRESSED;
+						p_Index->hold_tick = 0;
 						continue;                           
 					}
 					else
 					{
-						if(p_Index->hold_tick >= DESHAKE_SLICE * KEYSACN_TIMEBASE + SHORT_PRESS_PERIOD * KEYSACN_TIMEBASE)
+						/* 消抖完成即上报按下，早于后续判定 */
+						if((gesture & KEY_GES_DOWN) && !p_Index->down_sent
+							&& p_Index->hold_tick >= p_Index->deshake_tick)
+						{
+							p_Index->down_sent = true;
+							key_evt_record(p_Index,KEY_DOWN);
+						}
+						if(p_Index->hold_tick >= p_Index->deshake_tick + SHORT_PRESS_PERIOD * KEYSACN_TIMEBASE)
 						{
 							p_Index->key_state = KEY_PRESSED;
+							key_deshake_adapt(p_Index,period);
 						}
 					}
 				}
@@ -230,7 +496,7 @@ void key_scan(void)
 					}
 					else
 					{
-						if(p_Index->hold_tick >= DESHAKE_SLICE * KEYSACN_TIMEBASE + SHORT_PRESS_PERIOD * KEYSACN_TIMEBASE)
+						if(p_Index->hold_tick >= p_Index->deshake_tick + SHORT_PRESS_PERIOD * KEYSACN_TIMEBASE)
 						{
 							/* 双击成功，老铁666！ */
 							p_Index->key_state = KEY_DOUBELCLICK;
@@ -245,11 +511,21 @@ void key_scan(void)
 			case KEY_PRESSED:
 				if(KEY_UNPRESSED == key_instState)
 				{
+					/* 不使用双击，松开即上报短按 */
+					if(!(gesture & KEY_GES_DOUBLE))
+					{
+						p_Index->key_state = KEY_UNPRESSED;
+						p_Index->hold_tick = 0;
+						p_Index->down_sent = false;
+						if(gesture & KEY_GES_SHORT)
+							key_evt_record(p_Index,KEY_PRESSED);
+						continue;
+					}
 					p_Index->key_state = KEY_PROB_DOUBLECLICK;
 					p_Index->hold_tick = 0;
 					p_Index->timeout_tick = 0;
 				}
-				else if(p_Index->hold_tick >= LONG_PRESS_PERIOD * KEYSACN_TIMEBASE)
+				else if((gesture & KEY_GES_LONG) && p_Index->hold_tick >= LONG_PRESS_PERIOD * KEYSACN_TIMEBASE)
 				{
 					p_Index->key_state = KEY_LONGPRESSED;
 				}
@@ -258,7 +534,7 @@ void key_scan(void)
 				if(KEY_UNPRESSED == key_instState)
 				{
 					/* 未按下，则超时时间累加 */
-					p_Index->timeout_tick += KEYSACN_TIMEBASE;
+					p_Index->timeout_tick += period;
 
 					/* 双击失败，老铁不给力呀！ */
 					if(p_Index->timeout_tick >= 200)
@@ -266,7 +542,9 @@ void key_scan(void)
 						p_Index->key_state = KEY_UNPRESSED;
 						p_Index->hold_tick = 0;
 						p_Index->timeout_tick = 0;
-						key_evt_record(p_Index,KEY_PRESSED);
+						p_Index->down_sent = false;
+						if(gesture & KEY_GES_SHORT)
+							key_evt_record(p_Index,KEY_PRESSED);
 						continue;
 					}
 				}
@@ -281,6 +559,8 @@ void key_scan(void)
 				if(KEY_UNPRESSED == key_instState)
 				{
 					p_Index->key_state = KEY_UNPRESSED;
+					p_Index->hold_tick = 0;
+					p_Index->down_sent = false;
 				}
 				break;
 			case KEY_LONGPRESSED:
@@ -290,6 +570,7 @@ void key_scan(void)
 					if(KEY_UNPRESSED == key_instState)
 					{
 						p_Index->key_state = KEY_UNPRESSED;p_Index->hold_tick = 0;
+						p_Index->down_sent = false;
 						key_evt_record(p_Index,KEY_LONGPRESSED);
 						continue;
 					}
@@ -304,6 +585,7 @@ void key_scan(void)
 					{
 						p_Index->key_state = KEY_UNPRESSED;
 						p_Index->hold_tick = 0;
+						p_Index->down_sent = false;
 					}
 				}
 				break;
@@ -313,6 +595,145 @@ void key_scan(void)
 	}
 }
 
+/**********************************************************************
+ * 函数名称： key_scan_ctx
+ * 功能描述： 周期扫描指定上下文的按键键值，扫描周期固定为KEYSACN_TIMEBASE
+ * 输入参数： ctx
+ * 输出参数： 无
+ * 返 回 值： 无
+ ***********************************************************************/
+void key_scan_ctx(key_ctx_t *ctx)
+{
+	if(NULL == ctx)
+		return;
+	key_scan_period(ctx,KEYSACN_TIMEBASE,false);
+}
+
+/**********************************************************************
+ * 函数名称： key_scan
+ * 功能描述： 周期扫描按键键值，扫描周期固定为KEYSACN_TIMEBASE
+ * 输入参数： 无
+ * 输出参数： 无
+ * 返 回 值： 无
+ * 修改日期        版本号     修改人	      修改内容
+ * -----------------------------------------------
+ * 2023/08/31	    V1.0	  jinyicheng	      创建
+ ***********************************************************************/
+void key_scan(void)
+{
+	key_scan_ctx(&key_ctx_def);
+}
+
+/**********************************************************************
+ * 函数名称： key_scan_idle
+ * 功能描述： 判断是否全部按键空闲（未按下且无未完成的判定）
+ * 输入参数： ctx，snap 为true时判断快照按键，否则判断其余按键
+ * 输出参数： 无
+ * 返 回 值： true 空闲
+ ***********************************************************************/
+static bool key_scan_idle(key_ctx_t *ctx,bool snap)
+{
+	key_dev_t *p_Index;
+
+	for(p_Index = ctx->dev_head;NULL != p_Index;p_Index = p_Index->dev_next)
+	{
+		if((0 != p_Index->snap_mask) != snap)
+			continue;
+		if(KEY_UNPRESSED != p_Index->key_state || KEY_OFF != p_Index->last_level
+			|| p_Index->bounce_meas)
+			return false;
+	}
+	return true;
+}
+
+/**********************************************************************
+ * 函数名称： key_scan_dyn_ctx
+ * 功能描述： 动态周期扫描，返回距下次扫描的时间，由调用者安排下次调用
+ *           空闲时各按键计时均不累加，从空闲唤醒时按一个活动周期计时，
+ *           与固定周期扫描时首次检测到按下的计时一致，因此每次扫描均按
+ *           KEYSCAN_ACTIVE_PERIOD计时
+ * 输入参数： ctx
+ * 输出参数： 无
+ * 返 回 值： 距下次扫描的时间(ms)
+ ***********************************************************************/
+unsigned int key_scan_dyn_ctx(key_ctx_t *ctx)
+{
+	if(NULL == ctx)
+		return KEYSCAN_ACTIVE_PERIOD;
+
+	key_scan_period(ctx,KEYSCAN_ACTIVE_PERIOD,false);
+
+	return key_scan_idle(ctx,false) ? KEYSCAN_IDLE_PERIOD : KEYSCAN_ACTIVE_PERIOD;
+}
+
+/**********************************************************************
+ * 函数名称： key_scan_dyn
+ * 功能描述： 默认上下文的动态周期扫描
+ * 输入参数： 无
+ * 输出参数： 无
+ * 返 回 值： 距下次扫描的时间(ms)
+ ***********************************************************************/
+unsigned int key_scan_dyn(void)
+{
+	return key_scan_dyn_ctx(&key_ctx_def);
+}
+
+/**********************************************************************
+ * 函数名称： key_scan_block_ctx
+ * 功能描述： 块扫描，一次处理一组连续的端口快照（如DMA缓冲区），
+ *           每个快照按一次扫描处理，事件与逐次扫描相同
+ *           只处理设置了snap_mask的按键，其余按键仍需key_scan等逐次扫描，
+ *           快照按键空闲且快照中无按下时不会改变任何状态，直接跳过
+ *           事件在块处理结束后才能取出，块长度需考虑事件缓存上限
+ * 输入参数： ctx，snap 端口快照，num 快照数，period 快照间隔(ms)
+ * 输出参数： 无
+ * 返 回 值： 无
+ ***********************************************************************/
+void key_scan_block_ctx(key_ctx_t *ctx, const uint32_t *snap, unsigned int num, unsigned int period)
+{
+	key_dev_t *p_Index;
+	uint32_t mask_all = 0;
+	bool idle;
+
+	if(NULL == ctx || NULL == snap)
+		return;
+
+	for(p_Index = ctx->dev_head;NULL != p_Index;p_Index = p_Index->dev_next)
+	{
+		mask_all |= p_Index->snap_mask;
+	}
+	if(0 == mask_all)
+		return;
+	idle = key_scan_idle(ctx,true);
+
+	for(unsigned int n = 0; n < num; n++)
+	{
+		/* 快照中按键位为1即松开电平 */
+		if(idle && mask_all == (snap[n] & mask_all))
+			continue;
+
+		for(p_Index = ctx->dev_head;NULL != p_Index;p_Index = p_Index->dev_next)
+		{
+			if(0 != p_Index->snap_mask)
+				p_Index->ext_level = (KEY_STATE)((snap[n] & p_Index->snap_mask) ? 1 : 0);
+		}
+		key_scan_period(ctx,period,true);
+		idle = key_scan_idle(ctx,true);
+	}
+}
+
+/**********************************************************************
+ * 函数名称： key_scan_block
+ * 功能描述： 默认上下文的块扫描
+ * 输入参数： snap 端口快照，num 快照数，period 快照间隔(ms)
+ * 输出参数： 无
+ * 返 回 值： 无
+ ***********************************************************************/
+void key_scan_block(const uint32_t *snap, unsigned int num, unsigned int period)
+{
+	key_scan_block_ctx(&key_ctx_def,snap,num,period);
+}
+
 /**********************************************************************
  * 函数名称： key_handle_static
  * 功能描述： 固定逻辑控制
@@ -325,58 +746,74 @@ void key_scan(void)
  ***********************************************************************/
 void key_handle_static(key_dev_t *key_dev)
 {
-	if(NULL == key_dev->static_hand)
-		return;
 	if(NULL == key_dev->evt_Index)
 		return;
 
 	/* 回调处理,优先处理第一个事件节点，输入参数click类型 */
-	key_dev->static_hand(key_dev->evt_Index->key_val);
-	
-	unsigned char * p = (unsigned char *)key_dev->evt_Index;
-
-	/* 删除第一个事件节点 */
-	key_dev->evt_Index = key_dev->evt_Index->evt_next;
+	key_evt_dispatch(key_dev,key_dev->evt_Index->key_val);
 
-	/* 释放 */
-	tFreeHeapforeach(p);
+	/* 删除并释放第一个事件节点 */
+	key_evt_pop(key_dev);
 }
 
 /**********************************************************************
- * 函数名称： key_handle_dynamic
+ * 函数名称： key_handle_dynamic_ctx
  * 功能描述： 动态控制，如界面操作
- * 输入参数： 无
+ *           先处理最高优先级的事件，同优先级按事件先后处理
+ * 输入参数： ctx
  * 输出参数： 无
  * 返 回 值： 无
- * 修改日期        版本号     修改人	      修改内容
- * -----------------------------------------------
- * 2023/08/31	    V1.0	  jinyicheng	      创建
  ***********************************************************************/
-void key_handle_dynamic(void)
+void key_handle_dynamic_ctx(key_ctx_t *ctx)
 {
-	if(NULL == key_cbhead)
+	unsigned char prio_class;
+	uint32_t min = 0;
+	key_dev_t *key_index;
+	key_dev_t *key_to_handle = NULL;
+
+	if(NULL == ctx || NULL == ctx->dev_head)
 		return;
-	key_dev_t *key_index = key_cbhead;
-	
-	int min = key_index->evt_Index->prio;
-	key_dev_t *key_to_handle = key_cbhead;
-	
-	for(int i = 0; key_index != NULL; i++)
+
+	/* 找出有未处理事件的最高优先级 */
+	for(prio_class = KEY_PRIO_NUM; prio_class > 0 && 0 == ctx->prio_pending[prio_class - 1]; prio_class--);
+	if(0 == prio_class)
+		return;
+	prio_class--;
+
+	/* 同优先级中事件序号最小的先处理 */
+	for(key_index = ctx->dev_head; NULL != key_index; key_index = key_index->dev_next)
 	{
-		if(i >= 1)
-			key_index = key_index->dev_next;
-		if(min > key_index->evt_Index->prio)
+		if(prio_class != key_index->prio_class || NULL == key_index->evt_Index)
+			continue;
+		if(NULL == key_to_handle || min > key_index->evt_Index->prio)
 		{
 			key_to_handle = key_index;
 			min = key_index->evt_Index->prio;
 		}
 	}
-	key_handle_static(key_to_handle);
+	if(NULL != key_to_handle)
+		key_handle_static(key_to_handle);
+}
+
+/**********************************************************************
+ * 函数名称： key_handle_dynamic
+ * 功能描述： 默认上下文的动态控制
+ * 输入参数： 无
+ * 输出参数： 无
+ * 返 回 值： 无
+ * 修改日期        版本号     修改人	      修改内容
+ * -----------------------------------------------
+ * 2023/08/31	    V1.0	  jinyicheng	      创建
+ ***********************************************************************/
+void key_handle_dynamic(void)
+{
+	key_handle_dynamic_ctx(&key_ctx_def);
 }
 
 /**********************************************************************
  * 函数名称： key_upload
- * 功能描述： 注销按键
+ * 功能描述： 注销按键，从所属上下文的链表中移除，
+ *           按键结构体归调用者所有，注销后可重新注册
  * 输入参数： key_dev
  * 输出参数： 无
  * 返 回 值： 无
@@ -385,18 +822,268 @@ void key_handle_dynamic(void)
  * 2023/08/31	    V1.0	  jinyicheng	      创建
  ***********************************************************************/
 void key_upload(key_dev_t *key_dev)
+{
+	if(NULL == key_dev || NULL == key_dev->ctx)
+		return;
+	key_ctx_t *ctx = key_dev->ctx;
+	key_dev_t **pp_Index = &ctx->dev_head;
+	/* 从设备链表中摘除 */
+	while(NULL != *pp_Index && key_dev != *pp_Index)
+	{
+		pp_Index = &(*pp_Index)->dev_next;
+	}
+	if(NULL != *pp_Index)
+		*pp_Index = key_dev->dev_next;
+	key_dev->dev_next = NULL;
+	/* 释放未处理事件 */
+	while(NULL != key_dev->evt_Index)
+	{
+		key_evt_pop(key_dev);
+	}
+	/* 释放key_id并清空其路由，供之后注册的按键复用 */
+	if(key_dev->key_id < KEY_MAX_NUM)
+	{
+		ctx->id_used &= ~(1UL << key_dev->key_id);
+		memset(ctx->route[key_dev->key_id], 0, sizeof(ctx->route[0]));
+		memset(ctx->route_num[key_dev->key_id], 0, sizeof(ctx->route_num[0]));
+		key_dev->key_id = KEY_MAX_NUM;
+	}
+	key_dev->ctx = NULL;
+}
+
+/**********************************************************************
+ * 函数名称： key_set_policy
+ * 功能描述： 设置按键事件缓存溢出策略
+ * 输入参数： key_dev，policy
+ * 输出参数： 无
+ * 返 回 值： 无
+ ***********************************************************************/
+void key_set_policy(key_dev_t *key_dev, key_ovf_policy_t policy)
+{
+	if(NULL == key_dev)
+		return;
+	key_dev->ovf_policy = policy;
+}
+
+/**********************************************************************
+ * 函数名称： key_get_overflow
+ * 功能描述： 读取事件溢出次数
+ * 输入参数： key_dev，为NULL时返回默认上下文的溢出次数
+ * 输出参数： 无
+ * 返 回 值： 溢出次数
+ ***********************************************************************/
+unsigned int key_get_overflow(key_dev_t *key_dev)
+{
+	if(NULL == key_dev)
+		return key_ctx_def.evt_ovf;
+	return key_dev->evt_ovf;
+}
+
+/**********************************************************************
+ * 函数名称： key_ctx_overflow
+ * 功能描述： 读取上下文的事件溢出次数
+ * 输入参数： ctx
+ * 输出参数： 无
+ * 返 回 值： 溢出次数
+ ***********************************************************************/
+unsigned int key_ctx_overflow(key_ctx_t *ctx)
+{
+	if(NULL == ctx)
+		return 0;
+	return ctx->evt_ovf;
+}
+
+/**********************************************************************
+ * 函数名称： key_get_merged
+ * 功能描述： 读取按键第一个未处理事件被合并的次数，在事件处理函数中
+ *           调用即为正在处理的事件（处理完成后才删除该事件）
+ * 输入参数： key_dev
+ * 输出参数： 无
+ * 返 回 值： 合并次数，无未处理事件时为0
+ ***********************************************************************/
+unsigned int key_get_merged(key_dev_t *key_dev)
+{
+	if(NULL == key_dev || NULL == key_dev->evt_Index)
+		return 0;
+	return key_dev->evt_Index->merge_cnt;
+}
+
+/**********************************************************************
+ * 函数名称： key_subscribe
+ * 功能描述： 订阅按键事件，按事件类型掩码写入路由表
+ * 输入参数： key_dev，handler，evt_mask（KEY_EVT_MASK组合）
+ * 输出参数： 无
+ * 返 回 值： 0 成功，-1 参数错误或路由表已满
+ ***********************************************************************/
+int key_subscribe(key_dev_t *key_dev, key_sub_handler handler, unsigned int evt_mask)
+{
+	unsigned char i, val;
+
+	if(NULL == key_dev || NULL == handler || NULL == key_dev->ctx || key_dev->key_id >= KEY_MAX_NUM)
+		return -1;
+
+	/* 先检查所有相关表项是否有空位，避免只订阅一部分 */
+	for(val = 0; val < KEY_VAL_NUM; val++)
+	{
+		if(!(evt_mask & KEY_EVT_MASK(val)))
+			continue;
+		if(key_dev->ctx->route_num[key_dev->key_id][val] >= KEY_SUB_MAX)
+			return -1;
+	}
+
+	for(val = 0; val < KEY_VAL_NUM; val++)
+	{
+		if(!(evt_mask & KEY_EVT_MASK(val)))
+			continue;
+
+		key_sub_handler *route = key_dev->ctx->route[key_dev->key_id][val];
+		unsigned char *num = &key_dev->ctx->route_num[key_dev->key_id][val];
+
+		/* 已订阅则跳过 */
+		for(i = 0; i < *num && route[i] != handler; i++);
+		if(i < *num)
+			continue;
+
+		route[(*num)++] = handler;
+	}
+	return 0;
+}
+
+/**********************************************************************
+ * 函数名称： key_unsubscribe
+ * 功能描述： 取消订阅，从路由表删除掩码对应的表项
+ * 输入参数： key_dev，handler，evt_mask（KEY_EVT_MASK组合）
+ * 输出参数： 无
+ * 返 回 值： 无
+ ***********************************************************************/
+void key_unsubscribe(key_dev_t *key_dev, key_sub_handler handler, unsigned int evt_mask)
+{
+	unsigned char i, val;
+
+	if(NULL == key_dev || NULL == key_dev->ctx || key_dev->key_id >= KEY_MAX_NUM)
+		return;
+
+	for(val = 0; val < KEY_VAL_NUM; val++)
+	{
+		if(!(evt_mask & KEY_EVT_MASK(val)))
+			continue;
+
+		key_sub_handler *route = key_dev->ctx->route[key_dev->key_id][val];
+		unsigned char *num = &key_dev->ctx->route_num[key_dev->key_id][val];
+
+		for(i = 0; i < *num && route[i] != handler; i++);
+		if(i >= *num)
+			continue;
+
+		/* 保持订阅顺序，后续表项前移 */
+		for(; i + 1 < *num; i++)
+		{
+			route[i] = route[i + 1];
+		}
+		(*num)--;
+	}
+}
+
+/**********************************************************************
+ * 函数名称： key_get_deshake
+ * 功能描述： 读取按键当前消抖时间及测得的抖动时间，用于维护统计
+ * 输入参数： key_dev
+ * 输出参数： bounce_max 测得的最大抖动时间，可为NULL
+ * 返 回 值： 当前消抖时间(ms)
+ ***********************************************************************/
+unsigned int key_get_deshake(key_dev_t *key_dev, unsigned int *bounce_max)
+{
+	if(NULL == key_dev)
+		return 0;
+	if(NULL != bounce_max)
+		*bounce_max = key_dev->bounce_max;
+	return key_dev->deshake_tick;
+}
+
+/**********************************************************************
+ * 函数名称： key_set_gesture
+ * 功能描述： 声明按键使用的手势
+ * 输入参数： key_dev，gesture KEY_GES_xxx组合，0为KEY_GES_DEFAULT
+ * 输出参数： 无
+ * 返 回 值： 无
+ ***********************************************************************/
+void key_set_gesture(key_dev_t *key_dev, unsigned char gesture)
 {
 	if(NULL == key_dev)
 		return;
-	key_event_t * evt_to_del = key_dev->evt_Index;
-	for(int i = 0;evt_to_del != NULL; i++)
+	key_dev->gesture = gesture;
+}
+
+/**********************************************************************
+ * 函数名称： key_set_prio
+ * 功能描述： 设置按键优先级，已排队的事件随按键一起调整
+ * 输入参数： key_dev，prio_class KEY_PRIO_NORMAL ~ KEY_PRIO_CRITICAL
+ * 输出参数： 无
+ * 返 回 值： 无
+ ***********************************************************************/
+void key_set_prio(key_dev_t *key_dev, unsigned char prio_class)
+{
+	if(NULL == key_dev)
+		return;
+	if(prio_class >= KEY_PRIO_NUM)
+		prio_class = KEY_PRIO_CRITICAL;
+
+	if(NULL != key_dev->ctx)
 	{
-		if(i >= 1)
-			evt_to_del = evt_to_del->evt_next;
-		tFreeHeapforeach(evt_to_del);
+		key_dev->ctx->prio_pending[key_dev->prio_class] -= key_dev->evt_cnt;
+		key_dev->ctx->prio_pending[prio_class] += key_dev->evt_cnt;
 	}
-	key_dev_t * dev_to_del = key_dev;
-	tFreeHeapforeach(dev_to_del);
+	key_dev->prio_class = prio_class;
+}
+
+/**********************************************************************
+ * 函数名称： key_set_crit_direct
+ * 功能描述： 设置关键事件直接分发，开启后KEY_PRIO_CRITICAL按键的事件
+ *           不再入队，static_hand及订阅者在扫描上下文（如定时器中断）中
+ *           直接执行，需注意其执行时间及与主循环共享的数据
+ *           上下文未初始化时先初始化，之后注册按键不会清除该设置
+ * 输入参数： ctx，direct 为false时恢复入队
+ * 输出参数： 无
+ * 返 回 值： 无
+ ***********************************************************************/
+void key_set_crit_direct(key_ctx_t *ctx, bool direct)
+{
+	if(NULL == ctx)
+		return;
+	if(!ctx->ready)
+		key_ctx_init(ctx);
+	ctx->crit_direct = direct;
+}
+
+/**********************************************************************
+ * 函数名称： key_set_snapmask
+ * 功能描述： 设置按键在端口快照中的位，设置后按键电平来自块扫描的快照，
+ *           且只由块扫描处理，宜在注册按键之前调用，以免初始化GPIO
+ * 输入参数： key_dev，mask 为0时恢复读取GPIO并由逐次扫描处理，
+ *           已注册的按键此时初始化GPIO
+ * 输出参数： 无
+ * 返 回 值： 无
+ ***********************************************************************/
+void key_set_snapmask(key_dev_t *key_dev, uint32_t mask)
+{
+	if(NULL == key_dev)
+		return;
+	bool was_snap = (0 != key_dev->snap_mask);
+
+	key_dev->snap_mask = mask;
+	key_dev->ext_level = KEY_OFF;
+	if(0 != mask)
+	{
+		key_dev->ext_src = true;
+		return;
+	}
+	/* 其他外部输入（如ADC按键）不受影响 */
+	if(!was_snap)
+		return;
+	key_dev->ext_src = false;
+	/* 已注册的快照按键未初始化过GPIO */
+	if(NULL != key_dev->ctx)
+		key_io_Init(key_dev);
 }
 
 /* key operations collection */
@@ -405,5 +1092,28 @@ key_ops_t key_ops = {
 	.scan = key_scan,
 	.indiv_handler = key_handle_static,
 	.glob_handler = key_handle_dynamic,
-	.upload = key_upload
+	.upload = key_upload,
+	.set_policy = key_set_policy,
+	.overflow = key_get_overflow,
+	.merged = key_get_merged,
+	.subscribe = key_subscribe,
+	.unsubscribe = key_unsubscribe,
+	.deshake = key_get_deshake,
+	.set_gesture = key_set_gesture,
+	.scan_dyn = key_scan_dyn,
+	.set_prio = key_set_prio,
+	.set_snapmask = key_set_snapmask,
+	.scan_block = key_scan_block
+};
+
+/* key context operations collection */
+key_ctx_ops_t key_ctx_ops = {
+	.init = key_ctx_init,
+	.reg = key_Init_ctx,
+	.scan = key_scan_ctx,
+	.scan_dyn = key_scan_dyn_ctx,
+	.glob_handler = key_handle_dynamic_ctx,
+	.overflow = key_ctx_overflow,
+	.set_crit_direct = key_set_crit_direct,
+	.scan_block = key_scan_block_ctx
 };
\ No newline at end of file
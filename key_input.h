@@ -17,23 +17,76 @@ extern "C" {
 #define SHORT_PRESS_PERIOD 3
 #define LONG_PRESS_PERIOD 25
 
+/* 动态扫描周期(ms)：全部按键空闲时放慢，有按键活动时快于固定扫描周期，
+ * 消抖和手势计时更细，计时按实际周期累加，判定时间与固定周期扫描相同
+ * 空闲周期内按下的时长无法测得，短于 空闲周期+消抖+短按时间 的按键可能漏检 */
+#define KEYSCAN_IDLE_PERIOD 50
+#define KEYSCAN_ACTIVE_PERIOD (KEYSACN_TIMEBASE / 2)
+
+/* 自适应消抖时间范围(ms)，初始值为 DESHAKE_SLICE * KEYSACN_TIMEBASE
+ * 抖动每个扫描/快照周期采样一次，测量分辨率为一个周期，短于一个周期的抖动测得为0，
+ * 因此消抖时间不小于KEY_DESHAKE_MIN和扫描周期 */
+#define KEY_DESHAKE_MIN KEYSACN_TIMEBASE
+#define KEY_DESHAKE_MAX (5 * KEYSACN_TIMEBASE)
+
 /* 硬件电平 */
 #define KEY_ON 0
 #define KEY_OFF 1
 
+/* 事件缓存上限（单键/全局） */
+#define KEY_EVT_MAX_PER_KEY 8
+#define KEY_EVT_MAX_TOTAL 32
+
+/* 事件路由表规模 */
+#define KEY_MAX_NUM 8			/* 可路由的按键数，不超过32 */
+#if KEY_MAX_NUM > 32
+#error "KEY_MAX_NUM must not exceed 32"
+#endif
+#define KEY_VAL_NUM 6			/* key_val_t 取值范围 */
+#define KEY_SUB_MAX 4			/* 每个按键每种事件的订阅者数 */
+
+/* 按键优先级，数值越大越优先处理，同级按事件先后处理 */
+#define KEY_PRIO_NUM 4
+#define KEY_PRIO_NORMAL 0
+#define KEY_PRIO_CRITICAL (KEY_PRIO_NUM - 1)	/* 可在扫描中直接分发 */
+
 /* 逻辑控制/模拟量调节 */
 #define DIG 0
 #define ANA 1
 
 typedef enum {
     KEY_NONE 	= 0,
+    KEY_DOWN 	= 1,		/* 消抖后立即上报的按下事件 */
     KEY_SHORT 	= 2,
     KEY_LONG 	= 3,
+    KEY_UP 		= 4,		/* 已上报KEY_DOWN但未构成短按的松开，用于撤销KEY_DOWN */
 	KEY_DOUBLE	= 5,
 }key_val_t;
 
 typedef void (*key_static_handler)(key_val_t);
 
+/* 订阅者处理函数，参数带触发事件的按键，便于一个处理函数订阅多个按键 */
+struct stKey_dev;
+typedef void (*key_sub_handler)(struct stKey_dev *,key_val_t);
+
+/* 事件类型掩码，用于订阅过滤 */
+#define KEY_EVT_MASK(val) (1u << (val))
+#define KEY_EVT_ALL (KEY_EVT_MASK(KEY_DOWN) | KEY_EVT_MASK(KEY_SHORT) | KEY_EVT_MASK(KEY_LONG) | KEY_EVT_MASK(KEY_UP) | KEY_EVT_MASK(KEY_DOUBLE))
+
+/* 按键使用的手势，未使用双击的按键松开即上报短按，无需等待双击超时 */
+#define KEY_GES_SHORT 	0x01
+#define KEY_GES_LONG 	0x02
+#define KEY_GES_DOUBLE 	0x04
+#define KEY_GES_DOWN 	0x08		/* 每次手势消抖后先上报一次KEY_DOWN，未构成短按即松开时补报KEY_UP */
+#define KEY_GES_DEFAULT (KEY_GES_SHORT | KEY_GES_LONG | KEY_GES_DOUBLE)
+
+/* 事件缓存溢出策略 */
+typedef enum {
+	KEY_OVF_DROP_NEWEST = 0,	/* 丢弃新事件 */
+	KEY_OVF_DROP_OLDEST = 1,	/* 丢弃该键最早的事件 */
+	KEY_OVF_MERGE 		= 2,	/* 与该键最后一个同键值事件合并，无同键值事件时丢弃新事件 */
+}key_ovf_policy_t;
+
 typedef enum
 {
   KEY_UNPRESSED    	= 1,		/* 按键未按下 */
@@ -48,24 +101,69 @@ typedef struct stKey_event
 {
 	uint32_t prio;
 	key_val_t key_val;
+	unsigned int merge_cnt;		/* 被合并的事件数，处理时由key_ops.merged读取 */
 	struct stKey_event *evt_next;
 }key_event_t;
 
+struct stKey_ctx;
+
 typedef struct stKey_dev
 {
 	io_HandlerType key_io;		/* io底层操作（读写等） */
+	bool ext_src;				/* 电平由外部输入（如ADC），不读取GPIO */
+	KEY_STATE ext_level;		/* 外部输入的电平 */
+	uint32_t snap_mask;			/* 块采样时该按键在端口快照中的位，非0时只由块扫描处理 */
+	struct stKey_ctx *ctx;		/* 所属按键上下文，注册时指定 */
+	unsigned char key_id;		/* 路由表索引，注册时分配 */
+	unsigned char prio_class;	/* 优先级，KEY_PRIO_NORMAL ~ KEY_PRIO_CRITICAL */
 
 	bool ctrDorA;				/* 模拟量控制 */
+	unsigned char gesture;		/* KEY_GES_xxx组合，0为KEY_GES_DEFAULT */
+	bool down_sent;				/* 本次手势已上报KEY_DOWN */
 	char shortPressCnt;			/* 短时间内短按计数 */
 	unsigned int hold_tick;		/* 按键按下持续时间 */
 	unsigned int timeout_tick;	/* 各状态超时检测 */
 
 	key_state_t key_state;		/* 按键瞬时状态 */
+
+	unsigned int deshake_tick;	/* 当前消抖时间 */
+	unsigned int bounce_tick;	/* 最近一次测得的抖动时间，分辨率为扫描周期 */
+	unsigned int bounce_max;	/* 测得的最大抖动时间，分辨率为扫描周期 */
+	unsigned int edge_tick;		/* 测量中：距首个边沿的时间 */
+	unsigned int last_edge;		/* 测量中：最后一个边沿的时间 */
+	bool bounce_meas;			/* 是否正在测量抖动 */
+	KEY_STATE last_level;		/* 上一周期电平 */
 	key_static_handler static_hand;
 	struct stKey_dev *dev_next;
 	key_event_t *evt_Index;
+	key_event_t *evt_Tail;		/* 事件链表尾 */
+
+	key_ovf_policy_t ovf_policy;	/* 溢出策略 */
+	unsigned int evt_cnt;		/* 未处理事件数 */
+	unsigned int evt_ovf;		/* 溢出次数 */
 }key_dev_t;
 
+/* 按键上下文，持有设备链表、事件序号及事件存储，
+ * 不同上下文之间无共享状态，可在不同线程中分别扫描 */
+typedef struct stKey_ctx
+{
+	bool ready;					/* 已初始化 */
+	key_dev_t *dev_head;		/* 设备链表头 */
+	uint32_t pressed_cnt;		/* 事件序号 */
+	uint32_t id_used;			/* 已分配的key_id，按位记录，注销时释放 */
+
+	unsigned int evt_total;		/* 未处理事件数 */
+	unsigned int evt_ovf;		/* 溢出次数 */
+	key_event_t evt_pool[KEY_EVT_MAX_TOTAL];	/* 事件存储 */
+	key_event_t *evt_free;		/* 空闲事件链表 */
+	unsigned int prio_pending[KEY_PRIO_NUM];	/* 各优先级未处理事件数 */
+	bool crit_direct;			/* 关键事件不入队，在扫描上下文中直接分发 */
+
+	/* 事件路由表，按[按键][键值]索引，订阅时预先填好 */
+	key_sub_handler route[KEY_MAX_NUM][KEY_VAL_NUM][KEY_SUB_MAX];
+	unsigned char route_num[KEY_MAX_NUM][KEY_VAL_NUM];
+}key_ctx_t;
+
 typedef struct key_operations_struct
 {
 	void (* init)(key_dev_t *,key_static_handler);
@@ -73,11 +171,41 @@ typedef struct key_operations_struct
 	void (* indiv_handler)(key_dev_t *);
 	void (* glob_handler)(void);
 	void (* upload)(key_dev_t *);
+	void (* set_policy)(key_dev_t *,key_ovf_policy_t);
+	unsigned int (* overflow)(key_dev_t *);
+	unsigned int (* merged)(key_dev_t *);
+	int (* subscribe)(key_dev_t *,key_sub_handler,unsigned int);
+	void (* unsubscribe)(key_dev_t *,key_sub_handler,unsigned int);
+	unsigned int (* deshake)(key_dev_t *,unsigned int *);
+	void (* set_gesture)(key_dev_t *,unsigned char);
+	unsigned int (* scan_dyn)(void);
+	void (* set_prio)(key_dev_t *,unsigned char);
+	void (* set_snapmask)(key_dev_t *,uint32_t);
+	void (* scan_block)(const uint32_t *,unsigned int,unsigned int);
 }key_ops_t;
 
+/* 指定上下文的操作集，按键相关操作仍使用key_ops（按键记录了所属上下文）
+ * 上下文在init、set_crit_direct或注册第一个按键时初始化，init会清除全部设置，
+ * 需在set_crit_direct之前调用 */
+typedef struct key_ctx_operations_struct
+{
+	void (* init)(key_ctx_t *);
+	void (* reg)(key_ctx_t *,key_dev_t *,key_static_handler);
+	void (* scan)(key_ctx_t *);
+	unsigned int (* scan_dyn)(key_ctx_t *);
+	void (* glob_handler)(key_ctx_t *);
+	unsigned int (* overflow)(key_ctx_t *);
+	void (* set_crit_direct)(key_ctx_t *,bool);
+	void (* scan_block)(key_ctx_t *,const uint32_t *,unsigned int,unsigned int);
+}key_ctx_ops_t;
+
 extern key_dev_t key1,key2,key3,key4,key5,key6;//.......key_n
 extern key_ops_t key_ops;
 
+/* 默认上下文，key_ops中不带上下文的操作均作用于此 */
+extern key_ctx_t key_ctx_def;
+extern key_ctx_ops_t key_ctx_ops;
+
 /* 按键驱动框架基本数据结构如图，分为设备链表和事件链表
 *|-------------			|-------------
 *|key1        |			|key2    	 |
@@ -0,0 +1,16 @@
+/******************************************************************************************
+* @file         : bsp_gpio.c
+* @Description  : 主机版板级GPIO桩函数，主机上没有GPIO，读取时恒为高电平（松开）
+* ******************************************************************************************/
+#include "bsp_gpio.h"
+
+void xs_GpioInit(io_HandlerType *io)
+{
+	(void)io;
+}
+
+en_pin_state_t xs_GpioGetBit(io_HandlerType *io)
+{
+	(void)io;
+	return PinSet;
+}
@@ -0,0 +1,60 @@
+/******************************************************************************************
+* @file         : bsp_gpio.h
+* @Description  : 主机版板级GPIO接口，仅供tools下的主机工具编译使用
+*                 只提供key_input依赖的类型和函数，电平由工具自己的io操作给出
+* ******************************************************************************************/
+#ifndef BSP_GPIO_H
+#define BSP_GPIO_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+typedef enum
+{
+	PortA = 0,
+	PortB,
+	PortC,
+	PortD,
+}en_port_t;
+
+typedef enum
+{
+	Pin00 = 0,
+	Pin01,
+	Pin02,
+	Pin03,
+	Pin04,
+	Pin05,
+	Pin06,
+	Pin07,
+}en_pin_t;
+
+typedef enum
+{
+	PinReset = 0,
+	PinSet = 1,
+}en_pin_state_t;
+
+typedef struct
+{
+	en_port_t IO_PortSel;
+	en_pin_t IO_PinSel;
+}io_obj_t;
+
+typedef struct io_Handler
+{
+	io_obj_t io_obj;
+	void (* InitHandler)(struct io_Handler *);
+	en_pin_state_t (* GetbitHandler)(struct io_Handler *);
+}io_HandlerType;
+
+extern void xs_GpioInit(io_HandlerType *io);
+extern en_pin_state_t xs_GpioGetBit(io_HandlerType *io);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
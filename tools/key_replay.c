@@ -0,0 +1,489 @@
+/******************************************************************************************
+* @file         : key_replay.c
+* @Description  : Replay recorded pin waveforms through the key state machine (host tool)
+*
+ * 用法： key_replay [-r 采样率Hz] [-t 容差ms] [-v] <波形文件> <标注文件>
+ *   波形文件：.vcd 按$var出现顺序对应key0..keyN；其他后缀视为原始采样流，
+ *            每字节一个采样，bit n 为 keyn 的电平（1 松开，0 按下），最多CHAR_BIT个按键
+ *   标注文件：每行 "<时间ms> <按键序号> <S|L|D|P|U>"，#开头为注释，
+ *            P/U 为 KEY_DOWN/KEY_UP，出现时全部按键启用 KEY_GES_DOWN，需标注每次按下
+ * 在tools目录下执行 make 编译，板级GPIO使用 host/ 下的主机版，io操作由本工具接管
+ * ******************************************************************************************/
+#include "../include/key_input.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/* 波形结束后继续扫描的时间，保证双击超时等待结束 */
+#define REPLAY_TAIL_MS 1000
+/* 打印不匹配事件的最大条数 */
+#define REPLAY_PRINT_MAX 20
+
+typedef struct
+{
+	uint64_t t_ms;
+	unsigned char key;
+	unsigned char val;
+	unsigned char matched;
+}replay_evt_t;
+
+typedef struct
+{
+	replay_evt_t *buf;
+	size_t num;
+	size_t cap;
+}replay_list_t;
+
+static key_dev_t replay_key[KEY_MAX_NUM];
+static KEY_STATE replay_level[KEY_MAX_NUM];
+static unsigned int replay_key_num = 0;
+/* 标注中含 KEY_DOWN/KEY_UP 时启用 KEY_GES_DOWN */
+static bool replay_down = false;
+
+/* 当前回放时间 */
+static uint64_t replay_now_ms = 0;
+static replay_list_t replay_got, replay_exp;
+
+/**********************************************************************
+ * 函数名称： replay_list_add
+ * 功能描述： 事件列表追加
+ * 输入参数： list，t_ms，key，val
+ * 输出参数： 无
+ * 返 回 值： 0 成功，-1 内存不足
+ ***********************************************************************/
+static int replay_list_add(replay_list_t *list, uint64_t t_ms, unsigned char key, unsigned char val)
+{
+	if(list->num >= list->cap)
+	{
+		size_t cap = list->cap ? list->cap * 2 : 1024;
+		replay_evt_t *buf = (replay_evt_t *)realloc(list->buf, cap * sizeof(replay_evt_t));
+		if(NULL == buf)
+			return -1;
+		list->buf = buf;
+		list->cap = cap;
+	}
+	list->buf[list->num].t_ms = t_ms;
+	list->buf[list->num].key = key;
+	list->buf[list->num].val = val;
+	list->buf[list->num].matched = 0;
+	list->num++;
+	return 0;
+}
+
+/**********************************************************************
+ * 函数名称： replay_gpio_init / replay_gpio_getbit
+ * 功能描述： 替代板级GPIO，电平来自波形
+ ***********************************************************************/
+static void replay_gpio_init(io_HandlerType *io)
+{
+	(void)io;
+}
+
+static KEY_STATE replay_gpio_getbit(io_HandlerType *io)
+{
+	key_dev_t *key_dev = (key_dev_t *)((char *)io - offsetof(key_dev_t, key_io));
+
+	return replay_level[key_dev - replay_key];
+}
+
+/* 订阅全部按键事件，记录产生事件的按键号 */
+static void replay_on_key(key_dev_t *key_dev, key_val_t key_val)
+{
+	replay_list_add(&replay_got, replay_now_ms, (unsigned char)(key_dev - replay_key), (unsigned char)key_val);
+}
+
+/**********************************************************************
+ * 函数名称： replay_keys_init
+ * 功能描述： 注册回放按键，初始电平为松开
+ * 输入参数： num 按键数
+ * 输出参数： 无
+ * 返 回 值： 无
+ ***********************************************************************/
+static void replay_keys_init(unsigned int num)
+{
+	if(num > KEY_MAX_NUM)
+		num = KEY_MAX_NUM;
+
+	for(unsigned int i = 0; i < num; i++)
+	{
+		replay_level[i] = (KEY_STATE)KEY_OFF;
+		replay_key[i].key_io.InitHandler = replay_gpio_init;
+		replay_key[i].key_io.GetbitHandler = replay_gpio_getbit;
+		key_ops.init(&replay_key[i], NULL);
+		key_ops.subscribe(&replay_key[i], replay_on_key, KEY_EVT_ALL);
+		if(replay_down)
+			key_ops.set_gesture(&replay_key[i], KEY_GES_DEFAULT | KEY_GES_DOWN);
+	}
+	replay_key_num = num;
+}
+
+/**********************************************************************
+ * 函数名称： replay_tick
+ * 功能描述： 扫描一次并取出全部事件
+ * 输入参数： 无
+ * 输出参数： 无
+ * 返 回 值： 无
+ ***********************************************************************/
+static void replay_tick(void)
+{
+	key_ops.scan();
+
+	for(unsigned int i = 0; i < replay_key_num; i++)
+	{
+		while(NULL != replay_key[i].evt_Index)
+			key_ops.indiv_handler(&replay_key[i]);
+	}
+	replay_now_ms += KEYSACN_TIMEBASE;
+}
+
+/**********************************************************************
+ * 函数名称： replay_raw
+ * 功能描述： 回放原始采样流，按扫描周期取样，无需逐个采样处理，
+ *           每个采样一个字节，按键数为CHAR_BIT
+ * 输入参数： data，size，rate 采样率Hz
+ * 输出参数： 无
+ * 返 回 值： 0 成功
+ ***********************************************************************/
+static int replay_raw(const unsigned char *data, size_t size, unsigned int rate)
+{
+	uint64_t end_ms = (uint64_t)size * 1000 / rate;
+
+	replay_keys_init(KEY_MAX_NUM < CHAR_BIT ? KEY_MAX_NUM : CHAR_BIT);
+
+	for(; replay_now_ms < end_ms;)
+	{
+		size_t idx = (size_t)(replay_now_ms * rate / 1000);
+		unsigned char bits = data[idx];
+
+		for(unsigned int i = 0; i < replay_key_num; i++)
+			replay_level[i] = (KEY_STATE)((bits >> i) & 1);
+		replay_tick();
+	}
+	return 0;
+}
+
+/**********************************************************************
+ * 函数名称： replay_token
+ * 功能描述： 从内存映射的文本中取下一个以空白分隔的词
+ * 输入参数： pos 当前位置，end 结束位置
+ * 输出参数： len 词长度
+ * 返 回 值： 词首地址，结束时返回NULL
+ ***********************************************************************/
+static const char *replay_token(const char **pos, const char *end, size_t *len)
+{
+	const char *p = *pos;
+
+	while(p < end && (' ' == *p || '\t' == *p || '\r' == *p || '\n' == *p))
+		p++;
+	if(p >= end)
+		return NULL;
+
+	const char *tok = p;
+	while(p < end && !(' ' == *p || '\t' == *p || '\r' == *p || '\n' == *p))
+		p++;
+	*len = (size_t)(p - tok);
+	*pos = p;
+	return tok;
+}
+
+/**********************************************************************
+ * 函数名称： replay_vcd_unit
+ * 功能描述： 解析$timescale，返回每个时间单位的皮秒数
+ ***********************************************************************/
+static uint64_t replay_vcd_unit(const char *tok, size_t len)
+{
+	uint64_t mul = 0;
+	size_t i = 0;
+
+	for(; i < len && tok[i] >= '0' && tok[i] <= '9'; i++)
+		mul = mul * 10 + (uint64_t)(tok[i] - '0');
+	if(0 == mul)
+		mul = 1;
+	if(i >= len)
+		return mul;
+
+	switch(tok[i])
+	{
+		case 's': return mul * 1000000000000ull;
+		case 'm': return mul * 1000000000ull;
+		case 'u': return mul * 1000000ull;
+		case 'n': return mul * 1000ull;
+		case 'p': return mul;
+		default : return 1;	/* fs 按1ps处理 */
+	}
+}
+
+/**********************************************************************
+ * 函数名称： replay_vcd
+ * 功能描述： 流式回放VCD，按时间顺序应用电平变化并在扫描时刻扫描
+ * 输入参数： data，size
+ * 输出参数： 无
+ * 返 回 值： 0 成功，-1 格式错误
+ ***********************************************************************/
+static int replay_vcd(const char *data, size_t size)
+{
+	const char *pos = data, *end = data + size, *tok;
+	size_t len;
+	char id[KEY_MAX_NUM][16];
+	size_t id_len[KEY_MAX_NUM];
+	unsigned int id_num = 0;
+	uint64_t unit_ps = 1, scan_ps = 0;
+	const uint64_t period_ps = (uint64_t)KEYSACN_TIMEBASE * 1000000000ull;
+
+	/* 头部：时间单位与信号定义 */
+	while(NULL != (tok = replay_token(&pos, end, &len)))
+	{
+		if(0 == strncmp(tok, "$timescale", len) && 10 == len)
+		{
+			tok = replay_token(&pos, end, &len);
+			if(NULL == tok)
+				return -1;
+			/* 允许 "10 us" 形式，数字与单位分开 */
+			unit_ps = replay_vcd_unit(tok, len);
+			if(len > 0 && tok[len - 1] >= '0' && tok[len - 1] <= '9')
+			{
+				tok = replay_token(&pos, end, &len);
+				if(NULL == tok)
+					return -1;
+				unit_ps *= replay_vcd_unit(tok, len);
+			}
+		}
+		else if(0 == strncmp(tok, "$var", len) && 4 == len)
+		{
+			const char *code;
+			size_t code_len;
+
+			/* $var <type> <size> <id> <name> ... $end */
+			if(NULL == replay_token(&pos, end, &len)) return -1;
+			if(NULL == replay_token(&pos, end, &len)) return -1;
+			code = replay_token(&pos, end, &code_len);
+			if(NULL == code)
+				return -1;
+			if(id_num < KEY_MAX_NUM && code_len < sizeof(id[0]))
+			{
+				memcpy(id[id_num], code, code_len);
+				id_len[id_num] = code_len;
+				id_num++;
+			}
+		}
+		else if(0 == strncmp(tok, "$enddefinitions", len) && 15 == len)
+		{
+			break;
+		}
+	}
+	if(0 == id_num)
+		return -1;
+
+	replay_keys_init(id_num);
+
+	/* 数据段：#时间 与 标量变化 0id/1id */
+	while(NULL != (tok = replay_token(&pos, end, &len)))
+	{
+		if('#' == tok[0])
+		{
+			uint64_t t = 0;
+			for(size_t i = 1; i < len; i++)
+				t = t * 10 + (uint64_t)(tok[i] - '0');
+			t *= unit_ps;
+
+			/* 时间前进前，先完成之前所有扫描时刻 */
+			while(scan_ps < t)
+			{
+				replay_tick();
+				scan_ps += period_ps;
+			}
+		}
+		else if('0' == tok[0] || '1' == tok[0])
+		{
+			for(unsigned int i = 0; i < id_num; i++)
+			{
+				if(len - 1 == id_len[i] && 0 == memcmp(tok + 1, id[i], id_len[i]))
+				{
+					replay_level[i] = (KEY_STATE)(tok[0] - '0');
+					break;
+				}
+			}
+		}
+		else if('b' == tok[0] || 'B' == tok[0] || 'r' == tok[0] || 'R' == tok[0])
+		{
+			/* 向量/实数信号，跳过其id */
+			replay_token(&pos, end, &len);
+		}
+		/* x/z 及 $dumpvars 等保持原电平 */
+	}
+	return 0;
+}
+
+/**********************************************************************
+ * 函数名称： replay_load_annot
+ * 功能描述： 读取标注文件
+ * 输入参数： path
+ * 输出参数： 无
+ * 返 回 值： 0 成功，-1 失败
+ ***********************************************************************/
+static int replay_load_annot(const char *path)
+{
+	FILE *fp = fopen(path, "r");
+	char line[128];
+
+	if(NULL == fp)
+		return -1;
+
+	while(NULL != fgets(line, sizeof(line), fp))
+	{
+		unsigned long long t;
+		unsigned int key;
+		char type;
+		unsigned char val;
+
+		if('#' == line[0] || 3 != sscanf(line, "%llu %u %c", &t, &key, &type))
+			continue;
+		if('S' == type)
+			val = KEY_SHORT;
+		else if('L' == type)
+			val = KEY_LONG;
+		else if('D' == type)
+			val = KEY_DOUBLE;
+		else if('P' == type)
+			val = KEY_DOWN;
+		else if('U' == type)
+			val = KEY_UP;
+		else
+			continue;
+		if(KEY_DOWN == val || KEY_UP == val)
+			replay_down = true;
+		if(0 != replay_list_add(&replay_exp, t, (unsigned char)key, val))
+		{
+			fclose(fp);
+			return -1;
+		}
+	}
+	fclose(fp);
+	return 0;
+}
+
+/**********************************************************************
+ * 函数名称： replay_compare
+ * 功能描述： 比较产生的事件与标注，两者均按时间排序，容差内同键同值即匹配
+ * 输入参数： tol_ms，verbose
+ * 输出参数： 无
+ * 返 回 值： 不匹配事件数
+ ***********************************************************************/
+static size_t replay_compare(uint64_t tol_ms, int verbose)
+{
+	size_t base = 0, miss = 0, extra = 0, printed = 0;
+
+	for(size_t i = 0; i < replay_exp.num; i++)
+	{
+		replay_evt_t *exp = &replay_exp.buf[i];
+
+		/* 早于容差窗口的事件不会再被匹配 */
+		while(base < replay_got.num && replay_got.buf[base].t_ms + tol_ms < exp->t_ms)
+			base++;
+
+		for(size_t j = base; j < replay_got.num && replay_got.buf[j].t_ms <= exp->t_ms + tol_ms; j++)
+		{
+			replay_evt_t *got = &replay_got.buf[j];
+			if(!got->matched && got->key == exp->key && got->val == exp->val)
+			{
+				got->matched = exp->matched = 1;
+				break;
+			}
+		}
+		if(!exp->matched)
+		{
+			miss++;
+			if(verbose && printed++ < REPLAY_PRINT_MAX)
+				printf("missing    %llu ms key%u val%u\n", (unsigned long long)exp->t_ms, exp->key, exp->val);
+		}
+	}
+
+	for(size_t j = 0; j < replay_got.num; j++)
+	{
+		replay_evt_t *got = &replay_got.buf[j];
+		if(!got->matched)
+		{
+			extra++;
+			if(verbose && printed++ < REPLAY_PRINT_MAX)
+				printf("unexpected %llu ms key%u val%u\n", (unsigned long long)got->t_ms, got->key, got->val);
+		}
+	}
+
+	printf("replayed %llu ms, events %zu, expected %zu, missing %zu, unexpected %zu\n",
+		(unsigned long long)replay_now_ms, replay_got.num, replay_exp.num, miss, extra);
+	return miss + extra;
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned int rate = 1000;
+	uint64_t tol_ms = 300;
+	int verbose = 0, argi = 1, ret;
+
+	for(; argi < argc && '-' == argv[argi][0]; argi++)
+	{
+		if(0 == strcmp(argv[argi], "-r") && argi + 1 < argc)
+			rate = (unsigned int)strtoul(argv[++argi], NULL, 10);
+		else if(0 == strcmp(argv[argi], "-t") && argi + 1 < argc)
+			tol_ms = strtoull(argv[++argi], NULL, 10);
+		else if(0 == strcmp(argv[argi], "-v"))
+			verbose = 1;
+	}
+	if(argc - argi != 2 || 0 == rate)
+	{
+		fprintf(stderr, "usage: %s [-r rate_hz] [-t tol_ms] [-v] <capture> <annotations>\n", argv[0]);
+		return 2;
+	}
+
+	const char *cap = argv[argi], *annot = argv[argi + 1];
+	int fd = open(cap, O_RDONLY);
+	struct stat st;
+	if(fd < 0 || 0 != fstat(fd, &st) || 0 == st.st_size)
+	{
+		fprintf(stderr, "cannot open %s\n", cap);
+		return 2;
+	}
+
+	/* 映射整个波形文件，顺序读取 */
+	void *data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(MAP_FAILED == data)
+	{
+		fprintf(stderr, "cannot map %s\n", cap);
+		return 2;
+	}
+	madvise(data, (size_t)st.st_size, MADV_SEQUENTIAL);
+
+	if(0 != replay_load_annot(annot))
+	{
+		fprintf(stderr, "cannot read %s\n", annot);
+		return 2;
+	}
+
+	size_t cap_len = strlen(cap);
+	if(cap_len > 4 && 0 == strcmp(cap + cap_len - 4, ".vcd"))
+		ret = replay_vcd((const char *)data, (size_t)st.st_size);
+	else
+		ret = replay_raw((const unsigned char *)data, (size_t)st.st_size, rate);
+	munmap(data, (size_t)st.st_size);
+	if(0 != ret)
+	{
+		fprintf(stderr, "bad capture %s\n", cap);
+		return 2;
+	}
+
+	/* 所有按键松开，等待未完成的判定 */
+	for(unsigned int i = 0; i < replay_key_num; i++)
+		replay_level[i] = (KEY_STATE)KEY_OFF;
+	for(unsigned int t = 0; t < REPLAY_TAIL_MS; t += KEYSACN_TIMEBASE)
+		replay_tick();
+
+	return replay_compare(tol_ms, verbose) ? 1 : 0;
+}